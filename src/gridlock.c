@@ -0,0 +1,125 @@
+#include "gridlock.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct reader_slot {
+    alignas(64) atomic_int active;
+};
+
+static struct reader_slot *readers;
+static int readers_n;
+/* Set while the writer wants or holds the grid.
+ */
+static atomic_int writer_pending;
+/* Slow path only: the writer waits on readers_done for the readers inside
+ * to leave, blocked readers wait on writer_done for the frame to finish.
+ */
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readers_done = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_done = PTHREAD_COND_INITIALIZER;
+/* Writer statistics, only touched by the writer. */
+static long frames;
+static double wait_total_ms;
+static double wait_max_ms;
+
+int gridlock_init(int n_readers)
+{
+    int i;
+    /* aligned_alloc() wants a multiple of the alignment, which it is. */
+    readers = aligned_alloc(alignof(struct reader_slot),
+            (n_readers > 0 ? n_readers : 1) * sizeof *readers);
+    if (readers == NULL) {
+        return -1;
+    }
+    readers_n = n_readers;
+    for (i = 0; i < n_readers; i++) {
+        atomic_init(&readers[i].active, 0);
+    }
+    atomic_store(&writer_pending, 0);
+    frames = 0;
+    wait_total_ms = wait_max_ms = 0;
+    return 0;
+}
+
+void gridlock_destroy(void)
+{
+    free(readers);
+    readers = NULL;
+    readers_n = 0;
+}
+
+/* The reader announces itself before looking at writer_pending and the
+ * writer sets writer_pending before looking at the readers (both seq_cst),
+ * so at least one of them sees the other.
+ */
+void gridlock_read_lock(int reader)
+{
+    for (;;) {
+        atomic_store(&readers[reader].active, 1);
+        if (!atomic_load(&writer_pending)) {
+            return;
+        }
+        /* Back off, let the writer know and wait for the frame to end. */
+        atomic_store(&readers[reader].active, 0);
+        pthread_mutex_lock(&gate_lock);
+        pthread_cond_signal(&readers_done);
+        while (atomic_load(&writer_pending)) {
+            pthread_cond_wait(&writer_done, &gate_lock);
+        }
+        pthread_mutex_unlock(&gate_lock);
+    }
+}
+
+void gridlock_read_unlock(int reader)
+{
+    atomic_store(&readers[reader].active, 0);
+    if (atomic_load(&writer_pending)) {
+        pthread_mutex_lock(&gate_lock);
+        pthread_cond_signal(&readers_done);
+        pthread_mutex_unlock(&gate_lock);
+    }
+}
+
+void gridlock_write_lock(void)
+{
+    struct timespec start, end;
+    int i;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_mutex_lock(&gate_lock);
+    atomic_store(&writer_pending, 1);
+    for (i = 0; i < readers_n; i++) {
+        while (atomic_load(&readers[i].active)) {
+            pthread_cond_wait(&readers_done, &gate_lock);
+        }
+    }
+    pthread_mutex_unlock(&gate_lock);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wait_ms = (end.tv_sec - start.tv_sec) * 1e3 +
+        (end.tv_nsec - start.tv_nsec) / 1.0e6;
+    frames++;
+    wait_total_ms += wait_ms;
+    if (wait_ms > wait_max_ms) {
+        wait_max_ms = wait_ms;
+    }
+}
+
+void gridlock_write_unlock(void)
+{
+    pthread_mutex_lock(&gate_lock);
+    atomic_store(&writer_pending, 0);
+    pthread_cond_broadcast(&writer_done);
+    pthread_mutex_unlock(&gate_lock);
+}
+
+void gridlock_get_stats(struct gridlock_stats *stats)
+{
+    stats->frames = frames;
+    stats->wait_avg_ms = frames > 0 ? wait_total_ms / frames : 0;
+    stats->wait_max_ms = wait_max_ms;
+}
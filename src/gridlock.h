@@ -0,0 +1,40 @@
+#ifndef GRIDLOCK_H
+#define GRIDLOCK_H
+
+/* Reader-writer gate for whole grid accesses.
+ *
+ * Ant threads are readers: they hold the gate in read mode around a step,
+ * and lock individual cells inside it. The main thread is the only writer;
+ * it holds the gate in write mode to look at the whole grid at once.
+ *
+ * Every reader has its own cache line, so readers never write to shared
+ * memory on the fast path. A pending writer blocks new readers and waits
+ * only for the readers already inside, which bounds the writer's latency
+ * by the longest single step; readers wait for the writer only while a
+ * frame is actually pending.
+ */
+
+struct gridlock_stats {
+    long frames;
+    double wait_avg_ms;
+    double wait_max_ms;
+};
+
+/* Allocate the gate for readers in [0, n_readers).
+ * Returns 0 on success, -1 on error with errno set.
+ */
+int gridlock_init(int n_readers);
+void gridlock_destroy(void);
+/* A reader index must not be used by more than one thread at a time,
+ * and read sections must not nest.
+ */
+void gridlock_read_lock(int reader);
+void gridlock_read_unlock(int reader);
+void gridlock_write_lock(void);
+void gridlock_write_unlock(void);
+/* How long gridlock_write_lock() had to wait, over all the frames so far.
+ * Only the writer thread may call this.
+ */
+void gridlock_get_stats(struct gridlock_stats *stats);
+
+#endif /* GRIDLOCK_H */
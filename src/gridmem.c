@@ -0,0 +1,45 @@
+#include "gridmem.h"
+
+#include <sys/mman.h>
+
+/* Size of the mapping for an array, whole huge pages if it is worth it. */
+static size_t mapping_size(size_t elem_size)
+{
+    size_t size = GRID_CELLS * elem_size;
+    if (size >= GRID_HUGEPAGE) {
+        size = (size + GRID_HUGEPAGE - 1) / GRID_HUGEPAGE * GRID_HUGEPAGE;
+    }
+    return size;
+}
+
+void *gridmem_alloc(size_t elem_size)
+{
+    size_t size = mapping_size(elem_size);
+    void *mem;
+
+    if (size >= GRID_HUGEPAGE) {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            return mem;
+        }
+    }
+    /* No huge pages reserved, or too small to bother. */
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    if (size >= GRID_HUGEPAGE) {
+        /* Only a hint, fine if transparent huge pages are disabled. */
+        madvise(mem, size, MADV_HUGEPAGE);
+    }
+    return mem;
+}
+
+void gridmem_free(void *mem, size_t elem_size)
+{
+    if (mem != NULL) {
+        munmap(mem, mapping_size(elem_size));
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef GRIDMEM_H
+#define GRIDMEM_H
+
+#include "util.h"
+
+#include <stddef.h>
+
+/* Memory layout and allocation for arrays with one element per cell
+ * (the grid itself, the cell locks, ...).
+ *
+ * By default cells are stored in row-major order with every row padded to
+ * a multiple of GRID_ALIGN cells, so rows start on a cache line for any
+ * element size. Built with -DGRID_TILED, cells are stored in
+ * GRID_TILE x GRID_TILE tiles instead, so the 3x3 neighbourhood of a cell
+ * mostly falls into one tile: one cache line of the grid, one page of the
+ * locks. Always index these arrays with grid_index().
+ */
+
+#define GRID_ALIGN 64
+#define GRID_TILE 8
+#define GRID_HUGEPAGE (2 * 1024 * 1024)
+
+#ifdef GRID_TILED
+#define GRID_TILES ((GRIDSIZE + GRID_TILE - 1) / GRID_TILE)
+#define GRID_CELLS ((size_t)GRID_TILES * GRID_TILES * GRID_TILE * GRID_TILE)
+
+static inline size_t grid_index(int i, int j)
+{
+    size_t tile = (size_t)(i / GRID_TILE) * GRID_TILES + j / GRID_TILE;
+    return tile * GRID_TILE * GRID_TILE + (i % GRID_TILE) * GRID_TILE +
+        j % GRID_TILE;
+}
+#else
+#define GRID_STRIDE ((GRIDSIZE + GRID_ALIGN - 1) / GRID_ALIGN * GRID_ALIGN)
+#define GRID_CELLS ((size_t)GRIDSIZE * GRID_STRIDE)
+
+static inline size_t grid_index(int i, int j)
+{
+    return (size_t)i * GRID_STRIDE + j;
+}
+#endif
+
+/* Allocate zeroed memory for GRID_CELLS elements of the given size.
+ * Arrays of 2 MB or more are backed by huge pages if the system has them
+ * reserved, or else marked for transparent huge pages. Pages are not
+ * touched, so they are placed wherever they are first written to
+ * (see placement.h).
+ * Returns NULL on failure with errno set.
+ */
+void *gridmem_alloc(size_t elem_size);
+void gridmem_free(void *mem, size_t elem_size);
+
+#endif /* GRIDMEM_H */
@@ -1,16 +1,25 @@
+#include "gridlock.h"
+#include "gridmem.h"
+#include "placement.h"
+#include "record.h"
+#include "sched.h"
 #include "util.h"
+#include "workload.h"
 
 #include <assert.h>
 #include <curses.h>
 #include <errno.h>
+#include <math.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
 
 #define REPR_EMPTY '-'
 #define REPR_FOOD 'o'
@@ -33,6 +42,23 @@ struct coordinate {
     int y;
 };
 
+struct ant {
+    /* Used only if the ants run on the scheduler. */
+    struct sched_task task;
+    int id;
+    int colony;
+    /* Food picked up and dropped by the ant, see colonies_report(). */
+    long picked;
+    long dropped;
+    /* Reader index of the thread running the ant, see gridlock.h. */
+    int reader;
+    enum ant_state state;
+    struct coordinate pos;
+    int placed;
+    /* Number of putCharTo() calls since the counter was last reset. */
+    int writes;
+};
+
 /* Mutex protecting the number of sleepers,
  * i.e. the functions getSleeperN() and setSleeperN().
  */
@@ -51,95 +77,40 @@ static pthread_mutex_t delay_lock = PTHREAD_MUTEX_INITIALIZER;
  */
 static pthread_mutex_t running_lock = PTHREAD_MUTEX_INITIALIZER;
 static int running = 1;
-/* Locks for individual cells. Same size as the grid, stored in row-major order.
+/* Locks for individual cells. Same layout as the grid, see gridmem.h.
  * Allocated and initialized by ants_create(), free'd by ants_stop_join().
  */
 static pthread_mutex_t *cell_locks;
-/* Semaphore signalling if the grid is available, i.e. not used by any thread.
- * This will block the main thread from entering while there are ant threads
- * locking cells, but ant threads will still be able to lock cells independently
- * from each other. Required to implement the Lightswitch pattern.
+/* All the ants, allocated by ants_create(), free'd by ants_stop_join().
  */
-static sem_t grid_available;
-/* Number of locked cells and its mutex.
- * Required to implement the Lightswitch pattern, see Downey for details.
+static struct ant *ants;
+/* In event-driven mode, sleeping ants are parked here, indexed by their id,
+ * instead of being rescheduled. Protected by sleeper_lock.
  */
-static pthread_mutex_t cells_locked_lock = PTHREAD_MUTEX_INITIALIZER;
-static int cells_locked;
-/* Turnstile to prevent starvation of the main thread
- */
-static sem_t turnstile;
+static struct ant **parked_ants;
 
-static int sem_wait_nointr(sem_t *sem)
-{
-    int ret;
-    while ((ret = sem_wait(sem)) == -1 && errno == EINTR)
-        ;
-    return ret;
-}
-
-/* Lock the cell at the given position. If this is the first cell to be locked,
- * also block the main thread from doing a whole grid access (i.e. drawWindow()).
- * Other cells can still be locked independently.
- * We will implement a Lightswitch (see Downey) based pattern in order to
- * achieve this goal.
+/* Lock the cell at the given position. Other cells can still be locked
+ * independently. The caller must be inside a read section of the grid gate
+ * (see gridlock.h), which keeps the main thread from doing a whole grid
+ * access (i.e. drawWindow()) while ants hold cells.
  */
 static void lock_cell(int i, int j)
 {
-    /* Lightswitch pattern, lock phase */
-    pthread_mutex_lock(&cells_locked_lock);
-    if (++cells_locked == 1) {
-        /* First in locks. This lock will prevent the main thread from
-         * locking the grid while an ant thread holds a cell lock and an ant
-         * thread from locking a cell while the main thread holds the grid lock.
-         */
-        sem_wait_nointr(&grid_available);
-    }
-    pthread_mutex_unlock(&cells_locked_lock);
-
-    pthread_mutex_lock(&cell_locks[i*GRIDSIZE + j]);
+    placement_count(i);
+    pthread_mutex_lock(&cell_locks[grid_index(i, j)]);
 }
 
 static int trylock_cell(int i, int j)
 {
-    /* Lightswitch pattern, lock phase */
-    pthread_mutex_lock(&cells_locked_lock);
-    if (++cells_locked == 1) {
-        /* First in locks. This lock will prevent the main thread from
-         * locking the grid while an ant thread holds a cell lock and an ant
-         * thread from locking a cell while the main thread holds the grid lock.
-         */
-        sem_wait_nointr(&grid_available);
-    }
-    pthread_mutex_unlock(&cells_locked_lock);
-
-    if (pthread_mutex_trylock(&cell_locks[i*GRIDSIZE + j]) != 0) {
-        pthread_mutex_lock(&cells_locked_lock);
-        if (--cells_locked == 0) {
-            sem_post(&grid_available);
-        }
-        pthread_mutex_unlock(&cells_locked_lock);
-        return 0;
-    } else {
-        return 1;
-    }
+    placement_count(i);
+    return pthread_mutex_trylock(&cell_locks[grid_index(i, j)]) == 0;
 }
 
 /* Unlock the cell at the given position.
- * If this is the last cell to be unlocked, also unblock the main thread
- * from doing a whole grid access (i.e. drawWindow()).
  */
 static void unlock_cell(int i, int j)
 {
-    pthread_mutex_unlock(&cell_locks[i*GRIDSIZE + j]);
-
-    /* Lightswitch pattern, unlock phase */
-    pthread_mutex_lock(&cells_locked_lock);
-    if (--cells_locked == 0) {
-        /* Last out unlocks */
-        sem_post(&grid_available);
-    }
-    pthread_mutex_unlock(&cells_locked_lock);
+    pthread_mutex_unlock(&cell_locks[grid_index(i, j)]);
 }
 
 static char state_to_repr(enum ant_state state)
@@ -312,159 +283,317 @@ static int fill_neighbours(struct coordinate pos, struct coordinate *neighbours)
     return valid;
 }
 
-void *ant_main(void *arg)
+/* Puts c to the given cell on behalf of the ant, the cell must be locked.
+ * The number of writes is kept, see ant_run().
+ */
+static void ant_put(struct ant *ant, int i, int j, char c)
 {
-    enum ant_state state = STATE_ANT;
-    struct coordinate curr_pos;
-    struct coordinate neighbours_pos[8]; /* 8 neighbours */
-    int id = *(int*)arg;
-    free(arg);
+    putCharTo(i, j, c);
+    ant->writes++;
+}
+
+/* Puts the ant to its current cell with a representation matching its state.
+ */
+static void ant_show(struct ant *ant)
+{
+    gridlock_read_lock(ant->reader);
+    lock_cell(ant->pos.x, ant->pos.y);
+    ant_put(ant, ant->pos.x, ant->pos.y, state_to_repr(ant->state));
+    unlock_cell(ant->pos.x, ant->pos.y);
+    gridlock_read_unlock(ant->reader);
+}
 
-    /* Find somewhere to sit. */
-    while (curr_pos.x = rand() % GRIDSIZE, curr_pos.y = rand() % GRIDSIZE,
-            lock_cell(curr_pos.x, curr_pos.y),
-            lookCharAt(curr_pos.x, curr_pos.y) != REPR_EMPTY) {
-        unlock_cell(curr_pos.x, curr_pos.y);
+/* Find somewhere to sit, around the nest of the ant's colony. */
+static void ant_place(struct ant *ant)
+{
+    struct coordinate *pos = &ant->pos;
+    int attempt = 0;
+    gridlock_read_lock(ant->reader);
+    while (workload_nest_cell(ant->colony, attempt++, &pos->x, &pos->y),
+            lock_cell(pos->x, pos->y),
+            lookCharAt(pos->x, pos->y) != REPR_EMPTY) {
+        unlock_cell(pos->x, pos->y);
+    }
+    ant_put(ant, pos->x, pos->y, state_to_repr(ant->state));
+    unlock_cell(pos->x, pos->y);
+    gridlock_read_unlock(ant->reader);
+}
+
+/* Moves the ant one step, picking up or dropping food if it can.
+ * The ant must be awake.
+ */
+static void ant_move(struct ant *ant)
+{
+    struct coordinate neighbours_pos[8]; /* 8 neighbours */
+    struct coordinate curr_pos = ant->pos;
+    enum ant_state state = ant->state;
+
+    int valid_neighbours = fill_neighbours(curr_pos, neighbours_pos);
+    shuffle_array(neighbours_pos, ARRAY_SIZE(neighbours_pos));
+    gridlock_read_lock(ant->reader);
+    if (state == STATE_ANT) {
+        struct coordinate found_pos;
+        /* Check da hood for da food */
+        if (find_and_lock(neighbours_pos, valid_neighbours, REPR_FOOD, &found_pos)) {
+            lock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, curr_pos.x, curr_pos.y, REPR_EMPTY);
+            unlock_cell(curr_pos.x, curr_pos.y);
+            state = STATE_FOODANT;
+            ant->picked++;
+            ant_put(ant, found_pos.x, found_pos.y, state_to_repr(state));
+            unlock_cell(found_pos.x, found_pos.y);
+            curr_pos = found_pos;
+        } else if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_pos)) {
+            lock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, curr_pos.x, curr_pos.y, REPR_EMPTY);
+            unlock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, found_pos.x, found_pos.y, state_to_repr(state));
+            unlock_cell(found_pos.x, found_pos.y);
+            curr_pos = found_pos;
+        } /* else no food and no empty positions, do nothing */
+    } else if (state == STATE_FOODANT) {
+        struct coordinate found_food_pos;
+        struct coordinate found_empty_pos;
+        /* Check da hood for da food */
+        if (find_and_lock(neighbours_pos, valid_neighbours, REPR_FOOD, &found_food_pos)) {
+            /* XXX: Fixed the deadlock by attacking the no-preemption condition.
+             * Is there a better way to fix it, and does it even work
+             * properly now?
+             */
+            if (find_and_trylock(neighbours_pos, valid_neighbours - 1, REPR_EMPTY, &found_empty_pos)) {
+                lock_cell(curr_pos.x, curr_pos.y);
+                ant_put(ant, curr_pos.x, curr_pos.y, REPR_FOOD);
+                unlock_cell(curr_pos.x, curr_pos.y);
+                state = STATE_TIREDANT;
+                ant->dropped++;
+                ant_put(ant, found_empty_pos.x, found_empty_pos.y, state_to_repr(state));
+                unlock_cell(found_empty_pos.x, found_empty_pos.y);
+                curr_pos = found_empty_pos;
+            }
+            unlock_cell(found_food_pos.x, found_food_pos.y);
+        } else if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_empty_pos)) {
+            lock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, curr_pos.x, curr_pos.y, REPR_EMPTY);
+            unlock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, found_empty_pos.x, found_empty_pos.y, state_to_repr(state));
+            unlock_cell(found_empty_pos.x, found_empty_pos.y);
+            curr_pos = found_empty_pos;
+        }
+    } else /* if (state == STATE_TIREDANT) */ {
+        struct coordinate found_pos;
+        if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_pos)) {
+            lock_cell(curr_pos.x, curr_pos.y);
+            ant_put(ant, curr_pos.x, curr_pos.y, REPR_EMPTY);
+            unlock_cell(curr_pos.x, curr_pos.y);
+            state = STATE_ANT;
+            ant_put(ant, found_pos.x, found_pos.y, state_to_repr(state));
+            unlock_cell(found_pos.x, found_pos.y);
+            curr_pos = found_pos;
+        }
     }
-    putCharTo(curr_pos.x, curr_pos.y, state_to_repr(state));
-    unlock_cell(curr_pos.x, curr_pos.y);
+
+    gridlock_read_unlock(ant->reader);
+
+    ant->pos = curr_pos;
+    ant->state = state;
+}
+
+/* Delay between two steps of an ant, in microseconds. */
+static unsigned long step_delay_us(void)
+{
+    pthread_mutex_lock(&delay_lock);
+    int delay = getDelay();
+    pthread_mutex_unlock(&delay_lock);
+    return delay*1000 + (rand() % 5000);
+}
+
+/* Thread-per-ant mode, each ant thread runs this for its ant. */
+void *ant_main(void *arg)
+{
+    struct ant *ant = arg;
+
+    placement_bind(ant->id);
+    ant_place(ant);
 
     while (pthread_mutex_lock(&running_lock), running) {
         pthread_mutex_unlock(&running_lock);
 
         /* Check and sleep if necessary. */
-        assert(state_is_awake(state));
+        assert(state_is_awake(ant->state));
         pthread_mutex_lock(&sleeper_lock);
-        if (getSleeperN() > id) {
-            state = state_sleep(state);
-            lock_cell(curr_pos.x, curr_pos.y);
-            putCharTo(curr_pos.x, curr_pos.y, state_to_repr(state));
-            unlock_cell(curr_pos.x, curr_pos.y);
+        if (getSleeperN() > ant->id) {
+            ant->state = state_sleep(ant->state);
+            ant_show(ant);
         }
-        while (getSleeperN() > id) {
+        while (getSleeperN() > ant->id) {
             pthread_cond_wait(&sleeper_cond, &sleeper_lock);
         }
         pthread_mutex_unlock(&sleeper_lock);
 
         /* After a possible sleep */
-        if (state_is_asleep(state)) {
-            state = state_wake(state);
-            lock_cell(curr_pos.x, curr_pos.y);
-            putCharTo(curr_pos.x, curr_pos.y, state_to_repr(state));
-            unlock_cell(curr_pos.x, curr_pos.y);
-        }
-        assert(state_is_awake(state));
-
-        int valid_neighbours = fill_neighbours(curr_pos, neighbours_pos);
-        shuffle_array(neighbours_pos, ARRAY_SIZE(neighbours_pos));
-        sem_wait_nointr(&turnstile);
-        sem_post(&turnstile);
-        if (state == STATE_ANT) {
-            struct coordinate found_pos;
-            /* Check da hood for da food */
-            if (find_and_lock(neighbours_pos, valid_neighbours, REPR_FOOD, &found_pos)) {
-                lock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(curr_pos.x, curr_pos.y, REPR_EMPTY);
-                unlock_cell(curr_pos.x, curr_pos.y);
-                state = STATE_FOODANT;
-                putCharTo(found_pos.x, found_pos.y, state_to_repr(state));
-                unlock_cell(found_pos.x, found_pos.y);
-                curr_pos = found_pos;
-            } else if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_pos)) {
-                lock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(curr_pos.x, curr_pos.y, REPR_EMPTY);
-                unlock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(found_pos.x, found_pos.y, state_to_repr(state));
-                unlock_cell(found_pos.x, found_pos.y);
-                curr_pos = found_pos;
-            } /* else no food and no empty positions, do nothing */
-        } else if (state == STATE_FOODANT) {
-            struct coordinate found_food_pos;
-            struct coordinate found_empty_pos;
-            /* Check da hood for da food */
-            if (find_and_lock(neighbours_pos, valid_neighbours, REPR_FOOD, &found_food_pos)) {
-                /* XXX: Fixed the deadlock by attacking the no-preemption condition.
-                 * Is there a better way to fix it, and does it even work
-                 * properly now?
-                 */
-                if (find_and_trylock(neighbours_pos, valid_neighbours - 1, REPR_EMPTY, &found_empty_pos)) {
-                    lock_cell(curr_pos.x, curr_pos.y);
-                    putCharTo(curr_pos.x, curr_pos.y, REPR_FOOD);
-                    unlock_cell(curr_pos.x, curr_pos.y);
-                    state = STATE_TIREDANT;
-                    putCharTo(found_empty_pos.x, found_empty_pos.y, state_to_repr(state));
-                    unlock_cell(found_empty_pos.x, found_empty_pos.y);
-                    curr_pos = found_empty_pos;
-                }
-                unlock_cell(found_food_pos.x, found_food_pos.y);
-            } else if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_empty_pos)) {
-                lock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(curr_pos.x, curr_pos.y, REPR_EMPTY);
-                unlock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(found_empty_pos.x, found_empty_pos.y, state_to_repr(state));
-                unlock_cell(found_empty_pos.x, found_empty_pos.y);
-                curr_pos = found_empty_pos;
-            }
-        } else /* if (state == STATE_TIREDANT) */ {
-            struct coordinate found_pos;
-            if (find_and_lock(neighbours_pos, valid_neighbours, REPR_EMPTY, &found_pos)) {
-                lock_cell(curr_pos.x, curr_pos.y);
-                putCharTo(curr_pos.x, curr_pos.y, REPR_EMPTY);
-                unlock_cell(curr_pos.x, curr_pos.y);
-                state = STATE_ANT;
-                putCharTo(found_pos.x, found_pos.y, state_to_repr(state));
-                unlock_cell(found_pos.x, found_pos.y);
-                curr_pos = found_pos;
-            }
+        if (state_is_asleep(ant->state)) {
+            ant->state = state_wake(ant->state);
+            ant_show(ant);
         }
+        assert(state_is_awake(ant->state));
 
-        pthread_mutex_lock(&delay_lock);
-        int delay = getDelay();
-        pthread_mutex_unlock(&delay_lock);
-        usleep(delay*1000 + (rand() % 5000));
+        ant_move(ant);
+        usleep(step_delay_us());
     }
     pthread_mutex_unlock(&running_lock);
 
     return NULL;
 }
 
+/* Event-driven mode, one step of an ant on a scheduler worker.
+ * Instead of blocking, a sleeping ant is parked until unpark_ants() and
+ * the time putCharTo() would have slept is added to the ant's next due
+ * time, so a worker never sleeps on behalf of an ant.
+ */
+static void ant_run(struct sched_task *task, int worker)
+{
+    struct ant *ant = container_of(task, struct ant, task);
+
+    pthread_mutex_lock(&running_lock);
+    if (!running) {
+        pthread_mutex_unlock(&running_lock);
+        return;
+    }
+    pthread_mutex_unlock(&running_lock);
+
+    ant->reader = worker;
+    ant->writes = 0;
+    if (!ant->placed) {
+        ant_place(ant);
+        ant->placed = 1;
+    }
+
+    pthread_mutex_lock(&sleeper_lock);
+    if (getSleeperN() > ant->id) {
+        if (state_is_awake(ant->state)) {
+            ant->state = state_sleep(ant->state);
+            ant_show(ant);
+        }
+        parked_ants[ant->id] = ant;
+        pthread_mutex_unlock(&sleeper_lock);
+        return;
+    }
+    pthread_mutex_unlock(&sleeper_lock);
+
+    if (state_is_asleep(ant->state)) {
+        ant->state = state_wake(ant->state);
+        ant_show(ant);
+    }
+    ant_move(ant);
+
+    unsigned long delay_us = step_delay_us();
+    for (; ant->writes > 0; ant->writes--) {
+        delay_us += 1000 + (rand() % 500);
+    }
+    sched_add(&ant->task, delay_us);
+}
+
+/* Reschedule the parked ants which should be awake now.
+ * Caller must hold sleeper_lock.
+ */
+static void unpark_ants(int n_ants)
+{
+    int i;
+    for (i = getSleeperN(); i < n_ants; i++) {
+        if (parked_ants[i] != NULL) {
+            sched_add(&parked_ants[i]->task, 0);
+            parked_ants[i] = NULL;
+        }
+    }
+}
+
 static void print_usage(char **argv)
 {
-    fprintf(stderr, "Usage: %s n_ants n_food max_seconds\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-r record_file] [-n] [-w n_workers] [-N] [-f rate] [-H n_hotspots]\n"
+            "          [-c n_colonies] n_ants n_food max_seconds\n"
+            "  -r record_file  record the run to record_file, see record.h\n"
+            "  -n              do not draw the grid (no curses)\n"
+            "  -w n_workers    run the ants on an event scheduler with n_workers\n"
+            "                  threads instead of one thread per ant\n"
+            "  -N              pin threads to cores and place grid rows on NUMA\n"
+            "                  nodes, report cross-node cell accesses\n"
+            "  -f rate         put up to rate pieces of food per second back on\n"
+            "                  the grid, until there are n_food again\n"
+            "  -H n_hotspots   place food around n_hotspots random hotspots\n"
+            "                  instead of uniformly\n"
+            "  -c n_colonies   split the ants into colonies starting around\n"
+            "                  their own nests\n", argv[0]);
+}
+
+/* Initialize the cell locks of the rows owned by the given node, so they
+ * are placed on that node. See placement.h.
+ */
+static void init_lock_rows(int node, void *arg)
+{
+    int i, j, begin, end;
+    (void)arg;
+    placement_rows(node, &begin, &end);
+    for (i = begin; i < end; i++) {
+        for (j = 0; j < GRIDSIZE; j++) {
+            pthread_mutex_init(&cell_locks[grid_index(i, j)], NULL);
+        }
+    }
 }
 
-/* Allocate and initialize cell locks and create the ant threads.
+/* Allocate and initialize cell locks and create the ants, either as one
+ * thread per ant or, if n_workers > 0, as tasks on the event scheduler with
+ * n_workers worker threads.
  * If we happen to need any more resources for the ant threads in the future,
  * also allocate them here.
+ * Returns the ant threads, or NULL if the ants run on the scheduler.
  */
-static pthread_t *ants_create(int n_ants)
+static pthread_t *ants_create(int n_ants, int n_workers)
 {
     int i;
-    pthread_t *threads = malloc(n_ants * sizeof *threads);
+    pthread_t *threads = NULL;
 
     /* Allocate and initialize the cell locks and semaphores used.*/
-    cell_locks = malloc(GRIDSIZE * GRIDSIZE * sizeof *cell_locks);
-    for (i = 0; i < GRIDSIZE * GRIDSIZE; i++) {
-        pthread_mutex_init(&cell_locks[i], NULL);
-    }
-    if (sem_init(&grid_available, 0, 1) != 0) {
-        perror("ants_create(): sem_init()");
+    cell_locks = gridmem_alloc(sizeof *cell_locks);
+    if (cell_locks == NULL) {
+        perror("ants_create(): gridmem_alloc()");
         exit(EXIT_FAILURE);
     }
-    if (sem_init(&turnstile, 0, 1) != 0) {
-        perror("ants_create(): sem_init()");
+    placement_run_on_nodes(init_lock_rows, NULL);
+    /* Ant threads, or the workers running the ants, are the readers. */
+    if (gridlock_init(n_workers > 0 ? n_workers : n_ants) != 0) {
+        perror("ants_create(): gridlock_init()");
         exit(EXIT_FAILURE);
     }
 
+    ants = calloc(n_ants, sizeof *ants);
+    for (i = 0; i < n_ants; i++) {
+        ants[i].id = i;
+        ants[i].colony = workload_colony(i);
+        ants[i].reader = i;
+        ants[i].state = STATE_ANT;
+        ants[i].task.run = ant_run;
+    }
+
+    if (n_workers > 0) {
+        int err;
+        parked_ants = calloc(n_ants, sizeof *parked_ants);
+        /* Workers account for the write delay themselves. */
+        setWriteSleep(0);
+        if ((err = sched_start(n_workers, placement_bind)) != 0) {
+            errno = err;
+            perror("ants_create(): sched_start()");
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < n_ants; i++) {
+            sched_add(&ants[i].task, 0);
+        }
+        return NULL;
+    }
+
     /* Create the threads */
+    threads = malloc(n_ants * sizeof *threads);
     for (i = 0; i < n_ants; i++) {
-        /* If we pass &i, threads may get the wrong value if the loop
-         * goes on before they read *i. So we pass a copy of each i.
-         * The malloc'ed int is free'd by the thread that gets it.
-         */
-        int *id = malloc(sizeof *id);
-        *id = i;
-        if (pthread_create(&threads[i], NULL, ant_main, id) != 0) {
+        if (pthread_create(&threads[i], NULL, ant_main, &ants[i]) != 0) {
             perror("ants_create(): pthread_create()");
             exit(EXIT_FAILURE);
         }
@@ -472,10 +601,39 @@ static pthread_t *ants_create(int n_ants)
     return threads;
 }
 
+/* Print how much food each colony moved around, if there is more than one.
+ * The ants must not be running.
+ */
+static void colonies_report(int n_ants)
+{
+    int n_colonies = workload_colonies();
+    int colony, i;
+    if (n_colonies < 2) {
+        return;
+    }
+    long *picked = calloc(n_colonies, sizeof *picked);
+    long *dropped = calloc(n_colonies, sizeof *dropped);
+    if (picked == NULL || dropped == NULL) {
+        perror("colonies_report(): calloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n_ants; i++) {
+        picked[ants[i].colony] += ants[i].picked;
+        dropped[ants[i].colony] += ants[i].dropped;
+    }
+    for (colony = 0; colony < n_colonies; colony++) {
+        fprintf(stderr, "Colony %d: picked up %ld, dropped %ld food\n",
+                colony, picked[colony], dropped[colony]);
+    }
+    free(picked);
+    free(dropped);
+}
+
 /* Ant threads live for the lifetime of the program.
  * Before freeing global resources, we should stop and join them.
- * This function stops and joins the threads in the given array,
- * and it frees other resources (if there are any) allocated by ants_create().
+ * This function stops and joins the threads in the given array (or the
+ * scheduler, if threads is NULL), and it frees other resources
+ * (if there are any) allocated by ants_create().
  */
 static void ants_stop_join(pthread_t *threads, int n_ants)
 {
@@ -483,22 +641,90 @@ static void ants_stop_join(pthread_t *threads, int n_ants)
     pthread_mutex_lock(&running_lock);
     running = 0;
     pthread_mutex_unlock(&running_lock);
-    /* Wake all sleeping threads for them to be able to terminate.
-    */
-    pthread_mutex_lock(&sleeper_lock);
-    setSleeperN(0);
-    pthread_cond_broadcast(&sleeper_cond);
-    pthread_mutex_unlock(&sleeper_lock);
+    if (threads == NULL) {
+        /* Parked ants are simply never run again. */
+        sched_stop();
+        setWriteSleep(1);
+        free(parked_ants);
+    } else {
+        /* Wake all sleeping threads for them to be able to terminate.
+        */
+        pthread_mutex_lock(&sleeper_lock);
+        setSleeperN(0);
+        pthread_cond_broadcast(&sleeper_cond);
+        pthread_mutex_unlock(&sleeper_lock);
+        for (i = 0; i < n_ants; i++) {
+            if (pthread_join(threads[i], NULL) != 0) {
+                perror("ants_stop_join(): pthread_join()");
+                exit(EXIT_FAILURE);
+            }
+        }
+        free(threads);
+    }
+    colonies_report(n_ants);
+    free(ants);
+    gridmem_free(cell_locks, sizeof *cell_locks);
+    gridlock_destroy();
+}
+
+/* Number of pieces of food main() put on the grid. */
+static long food_placed;
+
+/* Pieces of food lying on the grid (not carried by ants). Ants pick up and
+ * drop food only inside read sections, so the caller must hold the grid
+ * in write mode, or the ants must not be running.
+ */
+static long food_on_grid(int n_ants)
+{
+    long food = food_placed;
+    int i;
     for (i = 0; i < n_ants; i++) {
-        if (pthread_join(threads[i], NULL) != 0) {
-            perror("ants_stop_join(): pthread_join()");
-            exit(EXIT_FAILURE);
+        food += ants[i].dropped - ants[i].picked;
+    }
+    return food;
+}
+
+/* Put a piece of food on an empty cell picked by the workload, or on the
+ * first empty cell from a random one on if the workload keeps missing.
+ * The caller must have the whole grid to itself.
+ * Returns 0 if there was no room for it.
+ */
+static int place_food(void)
+{
+    int attempt, k;
+    for (attempt = 0; attempt < WORKLOAD_TRIES + GRIDSIZE; attempt++) {
+        int a, b;
+        workload_food_cell(attempt, &a, &b);
+        if (lookCharAt(a, b) == REPR_EMPTY) {
+            putCharTo(a, b, REPR_FOOD);
+            food_placed++;
+            return 1;
+        }
+    }
+    int start = rand() % (GRIDSIZE * GRIDSIZE);
+    for (k = 0; k < GRIDSIZE * GRIDSIZE; k++) {
+        int cell = (start + k) % (GRIDSIZE * GRIDSIZE);
+        if (lookCharAt(cell / GRIDSIZE, cell % GRIDSIZE) == REPR_EMPTY) {
+            putCharTo(cell / GRIDSIZE, cell % GRIDSIZE, REPR_FOOD);
+            food_placed++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Empty the rows of the grid owned by the given node, see placement.h.
+ */
+static void fill_empty_rows(int node, void *arg)
+{
+    int i, j, begin, end;
+    (void)arg;
+    placement_rows(node, &begin, &end);
+    for (i = begin; i < end; i++) {
+        for (j = 0; j < GRIDSIZE; j++) {
+            putCharTo(i, j, REPR_EMPTY);
         }
     }
-    free(threads);
-    free(cell_locks);
-    sem_destroy(&grid_available);
-    sem_destroy(&turnstile);
 }
 
 int main(int argc, char **argv)
@@ -508,59 +734,151 @@ int main(int argc, char **argv)
     int n_ants;
     int n_food;
     int max_seconds;
-    if (argc != 4) {
+    const char *record_path = NULL;
+    int headless = 0;
+    int n_workers = 0;
+    int numa_aware = 0;
+    struct workload_config workload = { 0, 0, 1 };
+    int opt;
+    while ((opt = getopt(argc, argv, "r:nw:Nf:H:c:")) != -1) {
+        switch (opt) {
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'n':
+                headless = 1;
+                break;
+            case 'N':
+                numa_aware = 1;
+                break;
+            case 'f':
+                if (sscanf(optarg, "%lf", &workload.respawn_rate) != 1 ||
+                        !isfinite(workload.respawn_rate) ||
+                        workload.respawn_rate < 0) {
+                    print_usage(argv);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'H':
+                if (sscanf(optarg, "%d", &workload.n_hotspots) != 1 ||
+                        workload.n_hotspots < 0) {
+                    print_usage(argv);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                if (sscanf(optarg, "%d", &workload.n_colonies) != 1 ||
+                        workload.n_colonies < 1) {
+                    print_usage(argv);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'w':
+                if (sscanf(optarg, "%d", &n_workers) != 1 || n_workers < 0) {
+                    print_usage(argv);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage(argv);
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 3) {
         print_usage(argv);
-        return 1;
+        return EXIT_FAILURE;
     }
-    if (sscanf(argv[1], "%d", &n_ants) != 1) {
+    if (sscanf(argv[optind], "%d", &n_ants) != 1) {
         print_usage(argv);
         return EXIT_FAILURE;
     }
-    if (sscanf(argv[2], "%d", &n_food) != 1) {
+    if (sscanf(argv[optind + 1], "%d", &n_food) != 1 || n_food < 0 ||
+            n_food > GRIDSIZE * GRIDSIZE) {
         print_usage(argv);
         return EXIT_FAILURE;
     }
-    if (sscanf(argv[3], "%d", &max_seconds) != 1) {
+    if (sscanf(argv[optind + 2], "%d", &max_seconds) != 1) {
         print_usage(argv);
         return EXIT_FAILURE;
     }
 
+    if (numa_aware && placement_init(n_workers > 0 ? n_workers : n_ants) != 0) {
+        perror("main(): placement_init()");
+        return EXIT_FAILURE;
+    }
+
     /* Initialize grid with food at random locations.
-     * We are the only thread now, so we cool.
+     * We are the only thread now (the node threads touch disjoint rows),
+     * so we cool.
      */
-    int i, j;
-    for (i = 0; i < GRIDSIZE; i++) {
-        for (j = 0; j < GRIDSIZE; j++) {
-            putCharTo(i, j, REPR_EMPTY);
-        }
+    int i;
+    initGrid();
+    if (workload_init(&workload) != 0) {
+        perror("main(): workload_init()");
+        return EXIT_FAILURE;
     }
+    /* Setting up is not part of the simulation, do not slow it down. */
+    setWriteSleep(0);
+    placement_run_on_nodes(fill_empty_rows, NULL);
     for (i = 0; i < n_food; i++) {
-        int a, b;
-        do {
-            a = rand() % GRIDSIZE;
-            b = rand() % GRIDSIZE;
-        } while (lookCharAt(a, b) != REPR_EMPTY);
-        putCharTo(a, b, REPR_FOOD);
+        place_food();
     }
+    setWriteSleep(1);
 
-    startCurses();
-    pthread_t *ant_threads = ants_create(n_ants);
+    if (record_path != NULL && record_start(record_path) != 0) {
+        perror("main(): record_start()");
+        return EXIT_FAILURE;
+    }
+    if (!headless) {
+        startCurses();
+    }
+    pthread_t *ant_threads = ants_create(n_ants, n_workers);
     /* Ants are running. From now on, the grid must be protected.
      */
 
+    struct timespec prev_frame, curr_frame;
+    clock_gettime(CLOCK_MONOTONIC, &prev_frame);
     time_t start_time;
     time_t curr_time;
     for (start_time = time(NULL), curr_time = time(NULL);
             difftime(curr_time, start_time) < max_seconds;
             curr_time = time(NULL)) {
 
-        sem_wait_nointr(&turnstile);
-        sem_wait_nointr(&grid_available);
-        drawWindow();
-        sem_post(&turnstile);
-        sem_post(&grid_available);
+        clock_gettime(CLOCK_MONOTONIC, &curr_frame);
+        int respawn = workload_respawn_due((curr_frame.tv_sec - prev_frame.tv_sec) +
+                (curr_frame.tv_nsec - prev_frame.tv_nsec) / 1.0e9);
+        prev_frame = curr_frame;
 
-        int c = getch();
+        gridlock_write_lock();
+        /* Only top the food lying on the grid up to n_food, the ants never
+         * eat any; food they carry and drop later can still take it over
+         * n_food, by at most n_ants. Every ant takes a cell (a placed one,
+         * or soon), skip probing a full grid.
+         */
+        long food = food_on_grid(n_ants);
+        if (respawn > n_food - food) {
+            respawn = n_food - food;
+        }
+        if (respawn > GRIDSIZE * GRIDSIZE - n_ants - food) {
+            respawn = GRIDSIZE * GRIDSIZE - n_ants - food;
+        }
+        /* No ant is inside the grid, we can put food anywhere. Do not
+         * sleep in putCharTo() while every ant is locked out.
+         */
+        int write_sleep = getWriteSleep();
+        setWriteSleep(0);
+        for (; respawn > 0 && place_food(); respawn--)
+            ;
+        setWriteSleep(write_sleep);
+        if (!headless) {
+            drawWindow();
+        }
+        if (record_path != NULL) {
+            record_frame();
+        }
+        gridlock_write_unlock();
+
+        int c = headless ? ERR : getch();
         if (c == 'q' || c == ESC) {
             break;
         } else if (c == '+') {
@@ -582,13 +900,40 @@ int main(int argc, char **argv)
             pthread_mutex_lock(&sleeper_lock);
             setSleeperN(getSleeperN() - 1);
             pthread_cond_broadcast(&sleeper_cond);
+            if (ant_threads == NULL) {
+                unpark_ants(n_ants);
+            }
             pthread_mutex_unlock(&sleeper_lock);
         }
 
         usleep(DRAWDELAY);
     }
 
+    struct gridlock_stats frame_stats;
+    gridlock_get_stats(&frame_stats);
+    /* Close the window first, ants_stop_join() reports on stderr. */
+    if (!headless) {
+        endCurses();
+    }
     ants_stop_join(ant_threads, n_ants);
-    endCurses();
+    fprintf(stderr, "%ld frames, waited for the grid %.3f ms on average, "
+            "%.3f ms at most\n", frame_stats.frames, frame_stats.wait_avg_ms,
+            frame_stats.wait_max_ms);
+    if (numa_aware) {
+        long local, remote;
+        placement_get_counts(&local, &remote);
+        fprintf(stderr, "%d NUMA nodes, %ld local and %ld remote cell accesses "
+                "(%.1f%% remote)\n", placement_nodes(), local, remote,
+                local + remote > 0 ? 100.0 * remote / (local + remote) : 0);
+        placement_destroy();
+    }
+    workload_destroy();
+    freeGrid();
+    if (record_path != NULL) {
+        long dropped = record_stop();
+        if (dropped > 0) {
+            fprintf(stderr, "%ld frames dropped while recording\n", dropped);
+        }
+    }
     return 0;
 }
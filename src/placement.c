@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include "util.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NODE_DIR "/sys/devices/system/node"
+
+struct node {
+    cpu_set_t cpus;
+    int cpus_n;
+};
+
+struct counter {
+    alignas(64) long local;
+    long remote;
+};
+
+struct node_job {
+    void (*fn)(int node, void *arg);
+    void *arg;
+    int node;
+};
+
+static struct node *nodes;
+static int nodes_n = 1;
+static struct counter *counters;
+static int counters_n;
+/* Counter and node of the calling thread, set by placement_bind(). */
+static _Thread_local struct counter *self;
+static _Thread_local int self_node;
+
+/* Parse a list such as "0-3,8,10-11" into set, keeping only the CPUs
+ * which are also in allowed. Returns the number of CPUs in set.
+ */
+static int parse_cpulist(const char *list, const cpu_set_t *allowed,
+        cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    while (*list != '\0' && *list != '\n') {
+        char *end;
+        long first = strtol(list, &end, 10);
+        long last = first;
+        if (end == list) {
+            break;
+        }
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+        }
+        for (; first <= last && first < CPU_SETSIZE; first++) {
+            if (CPU_ISSET(first, allowed)) {
+                CPU_SET(first, set);
+            }
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(set);
+}
+
+/* Reads the CPUs of each node. Nodes without any usable CPUs (memory-only
+ * nodes or ones we are not allowed to run on) are left out; if there is no
+ * topology to read, everything is one node.
+ */
+static int read_nodes(void)
+{
+    cpu_set_t allowed;
+    int id;
+    int missing = 0;
+
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        return -1;
+    }
+    nodes = malloc(sizeof *nodes);
+    if (nodes == NULL) {
+        return -1;
+    }
+    nodes_n = 0;
+    /* Node ids may have holes, give up after a few missing ones. */
+    for (id = 0; missing < 8; id++) {
+        char path[64];
+        char list[1024];
+        snprintf(path, sizeof path, NODE_DIR "/node%d/cpulist", id);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            missing++;
+            continue;
+        }
+        missing = 0;
+        if (fgets(list, sizeof list, f) == NULL) {
+            list[0] = '\0';
+        }
+        fclose(f);
+
+        struct node *grown = realloc(nodes, (nodes_n + 1) * sizeof *nodes);
+        if (grown == NULL) {
+            return -1;
+        }
+        nodes = grown;
+        nodes[nodes_n].cpus_n = parse_cpulist(list, &allowed,
+                &nodes[nodes_n].cpus);
+        if (nodes[nodes_n].cpus_n > 0) {
+            nodes_n++;
+        }
+    }
+    if (nodes_n == 0) {
+        nodes[0].cpus = allowed;
+        nodes[0].cpus_n = CPU_COUNT(&allowed);
+        nodes_n = 1;
+    }
+    return 0;
+}
+
+int placement_init(int n_threads)
+{
+    int i;
+    if (read_nodes() != 0) {
+        placement_destroy();
+        return -1;
+    }
+    counters = aligned_alloc(alignof(struct counter),
+            (n_threads > 0 ? n_threads : 1) * sizeof *counters);
+    if (counters == NULL) {
+        placement_destroy();
+        return -1;
+    }
+    counters_n = n_threads;
+    for (i = 0; i < n_threads; i++) {
+        counters[i].local = counters[i].remote = 0;
+    }
+    return 0;
+}
+
+void placement_destroy(void)
+{
+    free(nodes);
+    free(counters);
+    nodes = NULL;
+    counters = NULL;
+    nodes_n = 1;
+    counters_n = 0;
+}
+
+int placement_nodes(void)
+{
+    return nodes_n;
+}
+
+void placement_rows(int node, int *begin, int *end)
+{
+    *begin = (node * GRIDSIZE + nodes_n - 1) / nodes_n;
+    *end = ((node + 1) * GRIDSIZE + nodes_n - 1) / nodes_n;
+}
+
+static int row_node(int row)
+{
+    return row * nodes_n / GRIDSIZE;
+}
+
+static void *node_job_main(void *arg)
+{
+    struct node_job *job = arg;
+    job->fn(job->node, job->arg);
+    return NULL;
+}
+
+void placement_run_on_nodes(void (*fn)(int node, void *arg), void *arg)
+{
+    int i;
+    if (nodes == NULL) {
+        fn(0, arg);
+        return;
+    }
+
+    pthread_t *threads = malloc(nodes_n * sizeof *threads);
+    struct node_job *jobs = malloc(nodes_n * sizeof *jobs);
+    if (threads == NULL || jobs == NULL) {
+        perror("placement_run_on_nodes(): malloc()");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nodes_n; i++) {
+        pthread_attr_t attr;
+        jobs[i].fn = fn;
+        jobs[i].arg = arg;
+        jobs[i].node = i;
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof nodes[i].cpus, &nodes[i].cpus);
+        if ((errno = pthread_create(&threads[i], &attr, node_job_main,
+                        &jobs[i])) != 0) {
+            perror("placement_run_on_nodes(): pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    for (i = 0; i < nodes_n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(jobs);
+}
+
+void placement_bind(int index)
+{
+    int node, nth, cpu;
+    cpu_set_t set;
+    if (nodes == NULL) {
+        return;
+    }
+    node = index % nodes_n;
+    nth = index / nodes_n % nodes[node].cpus_n;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &nodes[node].cpus) && nth-- == 0) {
+            break;
+        }
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof set, &set) != 0) {
+        perror("placement_bind(): sched_setaffinity()");
+    }
+    self = &counters[index];
+    self_node = node;
+}
+
+void placement_count(int row)
+{
+    if (self == NULL) {
+        return;
+    }
+    if (row_node(row) == self_node) {
+        self->local++;
+    } else {
+        self->remote++;
+    }
+}
+
+void placement_get_counts(long *local, long *remote)
+{
+    int i;
+    *local = *remote = 0;
+    for (i = 0; i < counters_n; i++) {
+        *local += counters[i].local;
+        *remote += counters[i].remote;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/* NUMA-aware thread and memory placement.
+ *
+ * The grid is split into bands of consecutive rows, one band per NUMA node.
+ * Memory for a band is placed on its node by first touch: whoever
+ * initializes the rows does so from placement_run_on_nodes(), on a CPU of
+ * the owning node. Bound threads are pinned to one core each, spread over
+ * the nodes, and count how many of their cell accesses hit a band of their
+ * own node.
+ *
+ * Until placement_init() is called there is a single node and nothing is
+ * pinned or counted.
+ */
+
+/* Read the node topology from sysfs and allocate counters for thread
+ * indices in [0, n_threads).
+ * Returns 0 on success, -1 on error with errno set.
+ */
+int placement_init(int n_threads);
+void placement_destroy(void);
+int placement_nodes(void);
+/* Rows [*begin, *end) of the grid belong to the given node. */
+void placement_rows(int node, int *begin, int *end);
+/* Run fn(node, arg) once for every node, on a thread running on that node,
+ * and wait for all of them to finish.
+ */
+void placement_run_on_nodes(void (*fn)(int node, void *arg), void *arg);
+/* Pin the calling thread to a core chosen by its index and start counting
+ * its accesses. An index must not be bound to more than one thread.
+ */
+void placement_bind(int index);
+/* Count an access to a cell in the given row by the calling thread. */
+void placement_count(int row);
+/* Sum of the counts of all the threads, they must not be running. */
+void placement_get_counts(long *local, long *remote);
+
+#endif /* PLACEMENT_H */
@@ -0,0 +1,228 @@
+#include "record.h"
+#include "util.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CELLS ((size_t)GRIDSIZE * GRIDSIZE)
+
+struct frame {
+    uint32_t number;
+    uint64_t time_ns;
+    char *cells;
+};
+
+/* Ring of snapshots shared by the main thread (producer) and the writer
+ * thread (consumer). head is only written by the consumer and tail only
+ * by the producer, they are kept on separate cache lines.
+ */
+static struct frame queue[RECORD_QUEUE_LEN];
+static alignas(64) atomic_ulong queue_head;
+static alignas(64) atomic_ulong queue_tail;
+/* Counts the frames in the queue, the writer thread sleeps on it.
+ */
+static sem_t frames_ready;
+static atomic_int stopping;
+
+static pthread_t writer_thread;
+static FILE *out;
+static char *prev_cells;
+static unsigned char *delta_buf;
+static struct timespec start_time;
+/* Frames written by the writer thread, and frames taken (including the
+ * dropped ones) by the main thread.
+ */
+static unsigned long frame_n;
+static unsigned long frames_taken;
+static long dropped;
+static int write_failed;
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start_time.tv_sec) * 1000000000u +
+        (uint64_t)now.tv_nsec - (uint64_t)start_time.tv_nsec;
+}
+
+static void put_u32(unsigned char *buf, uint32_t v)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        buf[i] = v >> (8 * i);
+    }
+}
+
+static void put_u64(unsigned char *buf, uint64_t v)
+{
+    int i;
+    for (i = 0; i < 8; i++) {
+        buf[i] = v >> (8 * i);
+    }
+}
+
+static void write_bytes(const void *buf, size_t n)
+{
+    if (write_failed) {
+        return;
+    }
+    if (fwrite(buf, 1, n, out) != n) {
+        perror("record: fwrite()");
+        write_failed = 1;
+    }
+}
+
+/* Write the frame either as a keyframe or as a delta against prev_cells,
+ * whichever is due (or smaller), and make it the new prev_cells.
+ */
+static void write_frame(const struct frame *frame)
+{
+    unsigned char header[13];
+    size_t i;
+    size_t n_changed = 0;
+    int keyframe = frame_n % RECORD_KEYFRAME_INTERVAL == 0;
+
+    if (!keyframe) {
+        for (i = 0; i < CELLS; i++) {
+            if (frame->cells[i] != prev_cells[i]) {
+                put_u32(delta_buf + 5 * n_changed, i);
+                delta_buf[5 * n_changed + 4] = frame->cells[i];
+                n_changed++;
+            }
+        }
+        /* A delta bigger than the grid itself is no use. */
+        keyframe = 5 * n_changed + 4 >= CELLS;
+    }
+
+    header[0] = keyframe ? 'K' : 'D';
+    put_u32(header + 1, frame->number);
+    put_u64(header + 5, frame->time_ns);
+    write_bytes(header, sizeof header);
+    if (keyframe) {
+        write_bytes(frame->cells, CELLS);
+    } else {
+        unsigned char count[4];
+        put_u32(count, n_changed);
+        write_bytes(count, sizeof count);
+        write_bytes(delta_buf, 5 * n_changed);
+    }
+    memcpy(prev_cells, frame->cells, CELLS);
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        while (sem_wait(&frames_ready) == -1 && errno == EINTR)
+            ;
+        unsigned long head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+        unsigned long tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+        if (head == tail) {
+            /* Only record_stop() posts without queueing a frame. */
+            if (atomic_load(&stopping)) {
+                break;
+            }
+            continue;
+        }
+        write_frame(&queue[head % RECORD_QUEUE_LEN]);
+        frame_n++;
+        atomic_store_explicit(&queue_head, head + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+int record_start(const char *path)
+{
+    int i;
+    int saved_errno;
+    unsigned char header[16];
+
+    out = fopen(path, "wb");
+    if (out == NULL) {
+        return -1;
+    }
+    prev_cells = malloc(CELLS);
+    delta_buf = malloc(5 * CELLS);
+    if (prev_cells == NULL || delta_buf == NULL) {
+        goto err;
+    }
+    for (i = 0; i < RECORD_QUEUE_LEN; i++) {
+        queue[i].cells = malloc(CELLS);
+        if (queue[i].cells == NULL) {
+            goto err;
+        }
+    }
+    if (sem_init(&frames_ready, 0, 0) != 0) {
+        goto err;
+    }
+
+    memcpy(header, RECORD_MAGIC, 8);
+    put_u32(header + 8, GRIDSIZE);
+    put_u32(header + 12, RECORD_KEYFRAME_INTERVAL);
+    write_bytes(header, sizeof header);
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    if ((errno = pthread_create(&writer_thread, NULL, writer_main, NULL)) != 0) {
+        sem_destroy(&frames_ready);
+        goto err;
+    }
+    return 0;
+
+err:
+    saved_errno = errno;
+    fclose(out);
+    free(prev_cells);
+    free(delta_buf);
+    for (i = 0; i < RECORD_QUEUE_LEN; i++) {
+        free(queue[i].cells);
+        queue[i].cells = NULL;
+    }
+    errno = saved_errno;
+    return -1;
+}
+
+void record_frame(void)
+{
+    unsigned long tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&queue_head, memory_order_acquire);
+    if (tail - head == RECORD_QUEUE_LEN) {
+        /* Writer is behind, never block the caller. */
+        frames_taken++;
+        dropped++;
+        return;
+    }
+    struct frame *frame = &queue[tail % RECORD_QUEUE_LEN];
+    frame->number = frames_taken++;
+    frame->time_ns = now_ns();
+    snapshotGrid(frame->cells);
+    atomic_store_explicit(&queue_tail, tail + 1, memory_order_release);
+    sem_post(&frames_ready);
+}
+
+long record_stop(void)
+{
+    int i;
+    atomic_store(&stopping, 1);
+    sem_post(&frames_ready);
+    pthread_join(writer_thread, NULL);
+    sem_destroy(&frames_ready);
+
+    if (fclose(out) != 0 && !write_failed) {
+        perror("record_stop(): fclose()");
+    }
+    free(prev_cells);
+    free(delta_buf);
+    for (i = 0; i < RECORD_QUEUE_LEN; i++) {
+        free(queue[i].cells);
+        queue[i].cells = NULL;
+    }
+    return dropped;
+}
@@ -0,0 +1,40 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+/* Streaming recorder for offline visualization.
+ *
+ * The main thread takes a snapshot of the grid with record_frame() while it
+ * has exclusive access to the grid (i.e. where it would call drawWindow()).
+ * Snapshots are handed over to a background thread through a lock-free
+ * single producer, single consumer queue; the background thread diffs them
+ * and does all the file I/O. If the writer falls behind, frames are dropped
+ * instead of blocking the main thread.
+ *
+ * File format, all integers little-endian:
+ *   header:   8 byte magic RECORD_MAGIC, u32 grid size, u32 keyframe interval
+ *   frame:    u8 type, u32 frame number, u64 nanoseconds since record_start()
+ *   type 'K': grid size * grid size bytes, the whole grid in row-major order
+ *   type 'D': u32 n, followed by n entries of u32 cell index (i*size + j)
+ *             and u8 new cell contents, relative to the previous frame
+ * Frame numbers are consecutive unless frames were dropped.
+ */
+
+#define RECORD_MAGIC "ANTREC1\n"
+#define RECORD_KEYFRAME_INTERVAL 64
+#define RECORD_QUEUE_LEN 16
+
+/* Open the file at path and start the writer thread.
+ * Returns 0 on success, -1 on error with errno set.
+ */
+int record_start(const char *path);
+/* Snapshot the grid and queue it for the writer thread.
+ * Must only be called by a single thread which has exclusive access
+ * to the grid.
+ */
+void record_frame(void);
+/* Flush the queued frames, stop the writer thread and close the file.
+ * Returns the number of frames dropped during the recording.
+ */
+long record_stop(void);
+
+#endif /* RECORD_H */
@@ -0,0 +1,262 @@
+#include "sched.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Each level of the wheel has WHEEL_SIZE slots and every slot of a level
+ * spans a whole turn of the level below it. Tasks further away than the
+ * last level can hold are kept in the overflow list.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 3
+
+struct task_list {
+    struct sched_task *head;
+    struct sched_task *tail;
+};
+
+/* Mutex protecting the wheel and the current tick.
+ */
+static pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct task_list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static struct task_list overflow;
+static unsigned long curr_tick;
+/* Tasks which are due, waiting for a worker, the mutex protecting them
+ * and the condition variable the idle workers wait on.
+ */
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+static struct task_list ready;
+/* Set by sched_stop(), protected by ready_lock. */
+static int stopping;
+
+static pthread_t timer_thread;
+static pthread_t *workers;
+static int workers_n;
+static void (*workers_init)(int worker);
+
+static void list_append(struct task_list *list, struct sched_task *task)
+{
+    task->next = NULL;
+    if (list->tail != NULL) {
+        list->tail->next = task;
+    } else {
+        list->head = task;
+    }
+    list->tail = task;
+}
+
+/* Move all the tasks in src to the end of dst. */
+static void list_splice(struct task_list *dst, struct task_list *src)
+{
+    if (src->head == NULL) {
+        return;
+    }
+    if (dst->tail != NULL) {
+        dst->tail->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    dst->tail = src->tail;
+    src->head = src->tail = NULL;
+}
+
+/* Put the task into the lowest level whose current turn contains its
+ * due tick. Tasks which are already due are appended to expired.
+ * Caller must hold wheel_lock.
+ */
+static void wheel_insert(struct sched_task *task, struct task_list *expired)
+{
+    int level;
+    if (task->due <= curr_tick) {
+        list_append(expired, task);
+        return;
+    }
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * (level + 1);
+        if (task->due >> shift == curr_tick >> shift) {
+            int slot = (task->due >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            list_append(&wheel[level][slot], task);
+            return;
+        }
+    }
+    list_append(&overflow, task);
+}
+
+/* Reinsert all the tasks in the list, relative to the current tick. */
+static void cascade(struct task_list *list, struct task_list *expired)
+{
+    struct sched_task *task = list->head;
+    list->head = list->tail = NULL;
+    while (task != NULL) {
+        struct sched_task *next = task->next;
+        wheel_insert(task, expired);
+        task = next;
+    }
+}
+
+/* Advance the wheel by one tick, appending the tasks due to expired.
+ * Higher levels are cascaded first when the lower ones wrap around, so
+ * a task moves down all the way in one go if it has to.
+ * Caller must hold wheel_lock.
+ */
+static void wheel_advance(struct task_list *expired)
+{
+    int level;
+    curr_tick++;
+    for (level = WHEEL_LEVELS; level > 0; level--) {
+        unsigned long mask = (1ul << (WHEEL_BITS * level)) - 1;
+        if ((curr_tick & mask) != 0) {
+            continue;
+        }
+        if (level == WHEEL_LEVELS) {
+            cascade(&overflow, expired);
+        } else {
+            int slot = (curr_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            cascade(&wheel[level][slot], expired);
+        }
+    }
+    list_splice(expired, &wheel[0][curr_tick & WHEEL_MASK]);
+}
+
+static void timespec_add_us(struct timespec *ts, unsigned long us)
+{
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static int timespec_before(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec < b->tv_sec ||
+        (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* Sleeps until the next tick on an absolute clock, so the ticks do not
+ * drift. If we wake up late, all the missed ticks are processed at once.
+ */
+static void *timer_main(void *arg)
+{
+    struct timespec next_tick;
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next_tick);
+    for (;;) {
+        timespec_add_us(&next_tick, SCHED_TICK_US);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_tick,
+                    NULL) == EINTR)
+            ;
+
+        struct task_list expired = { NULL, NULL };
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        pthread_mutex_lock(&wheel_lock);
+        wheel_advance(&expired);
+        while (timespec_before(&next_tick, &now)) {
+            timespec_add_us(&next_tick, SCHED_TICK_US);
+            wheel_advance(&expired);
+        }
+        pthread_mutex_unlock(&wheel_lock);
+
+        pthread_mutex_lock(&ready_lock);
+        if (stopping) {
+            pthread_mutex_unlock(&ready_lock);
+            break;
+        }
+        if (expired.head != NULL) {
+            list_splice(&ready, &expired);
+            pthread_cond_broadcast(&ready_cond);
+        }
+        pthread_mutex_unlock(&ready_lock);
+    }
+    return NULL;
+}
+
+static void *worker_main(void *arg)
+{
+    int id = (int)(long)arg;
+    if (workers_init != NULL) {
+        workers_init(id);
+    }
+    for (;;) {
+        pthread_mutex_lock(&ready_lock);
+        while (ready.head == NULL && !stopping) {
+            pthread_cond_wait(&ready_cond, &ready_lock);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&ready_lock);
+            break;
+        }
+        struct sched_task *task = ready.head;
+        ready.head = task->next;
+        if (ready.head == NULL) {
+            ready.tail = NULL;
+        }
+        pthread_mutex_unlock(&ready_lock);
+
+        task->run(task, id);
+    }
+    return NULL;
+}
+
+int sched_start(int n_workers, void (*worker_init)(int worker))
+{
+    int err;
+    workers_init = worker_init;
+    workers = malloc(n_workers * sizeof *workers);
+    if (workers == NULL) {
+        return ENOMEM;
+    }
+    stopping = 0;
+    if ((err = pthread_create(&timer_thread, NULL, timer_main, NULL)) != 0) {
+        free(workers);
+        return err;
+    }
+    for (workers_n = 0; workers_n < n_workers; workers_n++) {
+        if ((err = pthread_create(&workers[workers_n], NULL, worker_main,
+                        (void *)(long)workers_n)) != 0) {
+            sched_stop();
+            return err;
+        }
+    }
+    return 0;
+}
+
+void sched_add(struct sched_task *task, unsigned long delay_us)
+{
+    struct task_list expired = { NULL, NULL };
+    pthread_mutex_lock(&wheel_lock);
+    task->due = curr_tick + (delay_us + SCHED_TICK_US - 1) / SCHED_TICK_US;
+    wheel_insert(task, &expired);
+    pthread_mutex_unlock(&wheel_lock);
+
+    if (expired.head != NULL) {
+        pthread_mutex_lock(&ready_lock);
+        list_splice(&ready, &expired);
+        pthread_cond_signal(&ready_cond);
+        pthread_mutex_unlock(&ready_lock);
+    }
+}
+
+void sched_stop(void)
+{
+    int i;
+    pthread_mutex_lock(&ready_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&ready_cond);
+    pthread_mutex_unlock(&ready_lock);
+
+    pthread_join(timer_thread, NULL);
+    for (i = 0; i < workers_n; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    workers_n = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+/* Discrete-event scheduler: a hierarchical timer wheel driven by a single
+ * timer thread, dispatching due tasks to a pool of worker threads.
+ * Time is kept in ticks of SCHED_TICK_US microseconds; the timer thread is
+ * the only one sleeping on the clock, no matter how many tasks there are.
+ */
+
+#define SCHED_TICK_US 1000
+
+struct sched_task {
+    /* Called on a worker thread when the task is due. worker is the index
+     * of the worker, in [0, n_workers). The task is not in the scheduler
+     * while it runs, so it has to sched_add() itself to run again.
+     */
+    void (*run)(struct sched_task *task, int worker);
+    /* Private to the scheduler. */
+    struct sched_task *next;
+    unsigned long due;
+};
+
+/* Start the timer thread and n_workers worker threads. If worker_init is
+ * not NULL, every worker calls it with its index before running any tasks.
+ * Returns 0 on success, an error number on failure.
+ */
+int sched_start(int n_workers, void (*worker_init)(int worker));
+/* Schedule task to run delay_us microseconds from now, with a resolution of
+ * one tick. A task must not be added again before it has run.
+ */
+void sched_add(struct sched_task *task, unsigned long delay_us);
+/* Stop dispatching and join the threads. Tasks which are running are
+ * allowed to finish, pending tasks are never run; their memory is still
+ * owned by whoever added them.
+ */
+void sched_stop(void);
+
+#endif /* SCHED_H */
@@ -1,16 +1,20 @@
+#include "gridmem.h"
 #include "util.h"
 
 #include <curses.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
-static char grid[GRIDSIZE][GRIDSIZE];
+/* Allocated by initGrid(), indexed by grid_index(). */
+static char *grid;
 static int delay_n = 50;
 static int sleeper_n = 0;
-static long actions[GRIDSIZE][GRIDSIZE];
+static int write_sleep = 1;
+static long *actions;
 static long prev_actions = 0;
 static struct timespec time_pre;
 static WINDOW *gridworld = NULL;
@@ -53,17 +57,61 @@ int getSleeperN()
     return sleeper_n;
 }
 
+void initGrid()
+{
+    grid = gridmem_alloc(sizeof *grid);
+    actions = gridmem_alloc(sizeof *actions);
+    if (grid == NULL || actions == NULL) {
+        perror("initGrid(): gridmem_alloc()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void freeGrid()
+{
+    gridmem_free(grid, sizeof *grid);
+    gridmem_free(actions, sizeof *actions);
+    grid = NULL;
+    actions = NULL;
+}
+
+void setWriteSleep(int enabled)
+{
+    write_sleep = enabled;
+}
+
+int getWriteSleep()
+{
+    return write_sleep;
+}
+
 void putCharTo(int i, int j, char c)
 {
-    actions[i][j]++;
-    grid[i][j] = c;
-    usleep(1000 + (rand() % 500));
+    size_t k = grid_index(i, j);
+    actions[k]++;
+    grid[k] = c;
+    if (write_sleep) usleep(1000 + (rand() % 500));
 }
 
 char lookCharAt(int i, int j)
 {
-    actions[i][j]++;
-    return grid[i][j];
+    size_t k = grid_index(i, j);
+    actions[k]++;
+    return grid[k];
+}
+
+void snapshotGrid(char *dst)
+{
+#ifdef GRID_TILED
+    int i, j;
+    for (i = 0; i < GRIDSIZE; i++)
+        for (j = 0; j < GRIDSIZE; j++)
+            *dst++ = grid[grid_index(i, j)];
+#else
+    int i;
+    for (i = 0; i < GRIDSIZE; i++, dst += GRIDSIZE)
+        memcpy(dst, &grid[grid_index(i, 0)], GRIDSIZE);
+#endif
 }
 
 void startCurses()
@@ -75,7 +123,7 @@ void startCurses()
     int i,j;
     for (i = 0; i < GRIDSIZE; i++)
         for (j = 0; j < GRIDSIZE; j++){
-            actions[i][j] = 0;
+            actions[grid_index(i, j)] = 0;
         }
 }
 
@@ -110,7 +158,7 @@ void drawWindow()
         int i,j;
         for (i = 0; i < GRIDSIZE; i++)
             for (j = 0; j < GRIDSIZE; j++){
-                total_actions += actions[i][j];
+                total_actions += actions[grid_index(i, j)];
             }
         int n_actions = total_actions - prev_actions;
         prev_actions = total_actions;
@@ -125,8 +173,9 @@ void drawWindow()
         int nsants = 0;
         for (i = 0; i < GRIDSIZE; i++) {
             for (j = 0; j < GRIDSIZE; j++) {
-                mvwaddch(gridworld, i+1, 2*j+1, grid[i][j]);
-                switch (grid[i][j]) {
+                char c = grid[grid_index(i, j)];
+                mvwaddch(gridworld, i+1, 2*j+1, c);
+                switch (c) {
                     case 'P':
                         nants++;
                         nfoods++;
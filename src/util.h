@@ -3,14 +3,22 @@
 
 #define ESC 27
 #define DRAWDELAY 50000
+/* Can be overridden at build time, e.g. make CPPFLAGS=-DGRIDSIZE=1000 */
+#ifndef GRIDSIZE
 #define GRIDSIZE 30
+#endif
 
 void setDelay(int d);
 int getDelay();
 void setSleeperN(int d);
 int getSleeperN();
+void setWriteSleep(int enabled);
+int getWriteSleep();
+void initGrid();
+void freeGrid();
 void putCharTo(int i, int j, char c);
 char lookCharAt(int i, int j);
+void snapshotGrid(char *dst);
 void startCurses();
 void endCurses();
 void drawWindow();
@@ -0,0 +1,119 @@
+#include "workload.h"
+#include "util.h"
+
+#include <stdlib.h>
+
+struct point {
+    int i;
+    int j;
+};
+
+static struct workload_config config;
+static struct point *hotspots;
+static struct point *nests;
+/* Food owed to the grid, the fractional part is carried over. */
+static double respawn_debt;
+
+static void random_cell(struct point *p)
+{
+    p->i = rand() % GRIDSIZE;
+    p->j = rand() % GRIDSIZE;
+}
+
+/* Sum of two uniform offsets, so cells closer to the centre are likelier. */
+static int offset(void)
+{
+    return rand() % (WORKLOAD_RADIUS + 1) - rand() % (WORKLOAD_RADIUS + 1);
+}
+
+static int clamp(int x)
+{
+    return x < 0 ? 0 : x >= GRIDSIZE ? GRIDSIZE - 1 : x;
+}
+
+static void cell_around(const struct point *centre, int *i, int *j)
+{
+    *i = clamp(centre->i + offset());
+    *j = clamp(centre->j + offset());
+}
+
+int workload_init(const struct workload_config *conf)
+{
+    int k;
+    config = *conf;
+    if (config.n_colonies < 1) {
+        config.n_colonies = 1;
+    }
+    respawn_debt = 0;
+
+    if (config.n_hotspots > 0) {
+        hotspots = malloc(config.n_hotspots * sizeof *hotspots);
+        if (hotspots == NULL) {
+            return -1;
+        }
+        for (k = 0; k < config.n_hotspots; k++) {
+            random_cell(&hotspots[k]);
+        }
+    }
+    nests = malloc(config.n_colonies * sizeof *nests);
+    if (nests == NULL) {
+        workload_destroy();
+        return -1;
+    }
+    for (k = 0; k < config.n_colonies; k++) {
+        random_cell(&nests[k]);
+    }
+    return 0;
+}
+
+void workload_destroy(void)
+{
+    free(hotspots);
+    free(nests);
+    hotspots = nests = NULL;
+}
+
+void workload_food_cell(int attempt, int *i, int *j)
+{
+    if (config.n_hotspots == 0 || attempt >= WORKLOAD_TRIES) {
+        *i = rand() % GRIDSIZE;
+        *j = rand() % GRIDSIZE;
+        return;
+    }
+    cell_around(&hotspots[rand() % config.n_hotspots], i, j);
+}
+
+void workload_nest_cell(int colony, int attempt, int *i, int *j)
+{
+    /* A single colony has the whole grid to itself. */
+    if (config.n_colonies == 1 || attempt >= WORKLOAD_TRIES) {
+        *i = rand() % GRIDSIZE;
+        *j = rand() % GRIDSIZE;
+        return;
+    }
+    cell_around(&nests[colony], i, j);
+}
+
+int workload_colonies(void)
+{
+    return config.n_colonies;
+}
+
+int workload_colony(int ant_id)
+{
+    return ant_id % config.n_colonies;
+}
+
+int workload_respawn_due(double elapsed_s)
+{
+    int due;
+    respawn_debt += config.respawn_rate * elapsed_s;
+    /* Also keeps the conversion below in the range of int. */
+    if (!(respawn_debt < WORKLOAD_RESPAWN_MAX)) {
+        respawn_debt = 0;
+        return WORKLOAD_RESPAWN_MAX;
+    }
+    due = (int)respawn_debt;
+    respawn_debt -= due;
+    return due;
+}
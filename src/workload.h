@@ -0,0 +1,52 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+/* Workload generators, to drive the ants into more or less contended
+ * regimes: where food appears (uniformly or around a few hotspots), how fast
+ * it comes back, and how many colonies share the grid. Ants of a colony
+ * start around the colony's nest, so colonies meet at the borders between
+ * their territories.
+ */
+
+/* Offsets from a hotspot or nest are at most this far on either axis. */
+#define WORKLOAD_RADIUS (GRIDSIZE / 10 + 1)
+/* Number of attempts around a hotspot or nest before falling back to
+ * a uniformly random cell.
+ */
+#define WORKLOAD_TRIES (4 * WORKLOAD_RADIUS * WORKLOAD_RADIUS)
+/* At most this much food is respawned per call of workload_respawn_due(),
+ * so a slow frame does not make the next one slower still.
+ */
+#define WORKLOAD_RESPAWN_MAX 64
+
+struct workload_config {
+    /* 0 for uniformly distributed food. */
+    int n_hotspots;
+    /* Food to put back on the grid per second. */
+    double respawn_rate;
+    int n_colonies;
+};
+
+/* Pick the hotspots and nests for the given configuration.
+ * Returns 0 on success, -1 on error with errno set.
+ */
+int workload_init(const struct workload_config *config);
+void workload_destroy(void);
+/* Candidate cell for food. attempt counts the candidates already rejected
+ * by the caller for this piece of food.
+ */
+void workload_food_cell(int attempt, int *i, int *j);
+/* Candidate cell for an ant of the given colony to start at, attempt as in
+ * workload_food_cell().
+ */
+void workload_nest_cell(int colony, int attempt, int *i, int *j);
+int workload_colonies(void);
+/* Colony of the ant with the given id. */
+int workload_colony(int ant_id);
+/* Number of pieces of food to respawn, elapsed_s seconds after the
+ * previous call, at most WORKLOAD_RESPAWN_MAX; food owed beyond that is
+ * forgotten. Only one thread may call this.
+ */
+int workload_respawn_due(double elapsed_s);
+
+#endif /* WORKLOAD_H */